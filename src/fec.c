@@ -0,0 +1,88 @@
+/*
+Downlink FEC:
+- GF(256) log/antilog tables and RS generator built once at init
+- Systematic shortened Reed-Solomon encoder, table-driven LFSR
+- Byte-interleaved codewords over each 64-byte downlink block
+*/
+
+#include <gs/util/log.h>
+#include <string.h>
+#include "radfet.h"
+
+#define GF_POLY  0x11D
+
+#if (FEC_DATA_SIZE % FEC_INTERLEAVE) != 0
+#error "FEC_DATA_SIZE must be a multiple of FEC_INTERLEAVE"
+#endif
+
+static uint8_t gf_exp[512];   // doubled so log sums need no modulo
+static uint8_t gf_log[256];
+static uint8_t genpoly[FEC_NROOTS + 1];   // g[0] .. g[NROOTS], monic
+static bool    fec_ready = false;
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+void fec_init(void) {
+    if (fec_ready) return;
+
+    uint16_t x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= GF_POLY;
+    }
+    for (int i = 255; i < 512; i++) {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+    gf_log[0] = 0;   // unused; gf_mul guards zero
+
+    // g(x) = (x - a^0)(x - a^1)...(x - a^(NROOTS-1))
+    memset(genpoly, 0, sizeof(genpoly));
+    genpoly[0] = 1;
+    for (int i = 0; i < FEC_NROOTS; i++) {
+        uint8_t root = gf_exp[i];
+        for (int k = i + 1; k > 0; k--) {
+            genpoly[k] = genpoly[k - 1] ^ gf_mul(genpoly[k], root);
+        }
+        genpoly[0] = gf_mul(genpoly[0], root);
+    }
+
+    fec_ready = true;
+    log_info("FEC ready: RS(%d,%d) x%d per %d-byte block",
+             FEC_DATA_SIZE / FEC_INTERLEAVE + FEC_NROOTS, FEC_DATA_SIZE / FEC_INTERLEAVE,
+             FEC_INTERLEAVE, FEC_DATA_SIZE);
+}
+
+// frame[0..63] = data as-is; parity byte j of codeword c at 64 + j*I + c.
+// Codeword c holds data bytes c, c+I, c+2I, ...
+void fec_encode_block(const uint8_t *data, uint8_t *frame) {
+    memcpy(frame, data, FEC_DATA_SIZE);
+
+    for (int c = 0; c < FEC_INTERLEAVE; c++) {
+        uint8_t r[FEC_NROOTS];
+        memset(r, 0, sizeof(r));
+
+        for (int i = c; i < FEC_DATA_SIZE; i += FEC_INTERLEAVE) {
+            uint8_t fb = data[i] ^ r[0];
+            if (fb != 0) {
+                uint8_t fb_log = gf_log[fb];
+                for (int j = 0; j < FEC_NROOTS - 1; j++) {
+                    uint8_t g = genpoly[FEC_NROOTS - 1 - j];
+                    r[j] = r[j + 1] ^ (g ? gf_exp[fb_log + gf_log[g]] : 0);
+                }
+                r[FEC_NROOTS - 1] = gf_exp[fb_log + gf_log[genpoly[0]]];
+            } else {
+                memmove(r, r + 1, FEC_NROOTS - 1);
+                r[FEC_NROOTS - 1] = 0;
+            }
+        }
+
+        for (int j = 0; j < FEC_NROOTS; j++) {
+            frame[FEC_DATA_SIZE + j * FEC_INTERLEAVE + c] = r[j];
+        }
+    }
+}
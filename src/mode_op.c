@@ -21,18 +21,427 @@
 #include <gs/util/string.h>
 #include <gs/util/mutex.h>
 #include <gs/embed/drivers/flash/mcu_flash.h>
+#include <compiler.h>  // libasf, Get_system_register
 
 // Constants
 #define USART1 1
 #define STX 0x02
+#define EVT 0x05   // dump event capture region
+#define STX_PROG 0x06   // ring dump, coarse-to-fine interleave
+#define FEC_ON 0x07     // RS-encode subsequent bulk dumps
+#define FEC_OFF 0x08
+#define DIGEST 0x09     // + u16 node (high byte first): ACK + node + children, or NAK
+#define PAGE 0x0A       // + u16 page (high byte first): ACK + one raw ring page, or NAK
+#define EVT_ON 0x0B     // start high-rate event capture
+#define EVT_OFF 0x0C
+#define EVT_CFG 0x0D    // + u16 rate_ms, u16 delta, u16 abs (each high byte first)
+#define SETTLE 0x0E     // bias settle telemetry (radfet_settle_stats_t)
 #define NUM_SAMPLES_TO_SEND (60 * 24 * 5)
 #define BLOCK_SIZE 64
+#define PROG_MAX_STRIDE 64   // first progressive pass: every 64th sample
 
 // Derived from radfet.h
 #define PKT_SIZE            (sizeof(radfet_packet_t))
 #define RING_CAP_PACKETS    (RADFET_FLASH_SIZE / PKT_SIZE)
 #define RING_CAP_BYTES      (RING_CAP_PACKETS * PKT_SIZE)
 
+// 64-byte block staging for UART downlink
+typedef struct {
+    uint8_t  buf[BLOCK_SIZE];
+    size_t   used;
+    size_t   planned;     // bytes handed to tx_append
+    size_t   sent;        // bytes accepted by the UART
+    bool     fec;         // send FEC_FRAME_SIZE RS frames instead of raw blocks
+    uint32_t fec_frames;
+    uint32_t fec_cycles;  // CPU cycles spent in fec_encode_block
+} tx_stream_t;
+
+#if BLOCK_SIZE != FEC_DATA_SIZE
+#error "FEC frames must cover exactly one downlink block"
+#endif
+
+// Applies to bulk dumps (STX, STX_PROG, EVT) only; short query replies
+// (DIGEST, PAGE, ...) always go out raw so their lengths stay fixed.
+static bool fec_enabled = false;
+
+static void tx_init(tx_stream_t *tx, bool bulk) {
+    memset(tx, 0, sizeof(*tx));
+    tx->fec = bulk && fec_enabled;
+}
+
+// Encode the full staging block and push the whole frame out
+static gs_error_t tx_send_fec(tx_stream_t *tx) {
+    uint8_t frame[FEC_FRAME_SIZE];
+
+    uint32_t t0 = Get_system_register(AVR32_COUNT);
+    fec_encode_block(tx->buf, frame);
+    tx->fec_cycles += Get_system_register(AVR32_COUNT) - t0;
+    tx->fec_frames++;
+
+    size_t done = 0;
+    while (done < FEC_FRAME_SIZE) {
+        size_t block_sent = 0;
+        gs_error_t err = gs_uart_write_buffer(USART1, 1000, frame + done, FEC_FRAME_SIZE - done, &block_sent);
+        if (err != GS_OK || block_sent == 0) {
+            log_error("UART FEC frame error at %u/%u planned bytes: %s (sent %u of %u)",
+                      (unsigned int)tx->sent,
+                      (unsigned int)tx->planned,
+                      gs_error_string(err),
+                      (unsigned int)(done + block_sent),
+                      (unsigned int)FEC_FRAME_SIZE);
+            return (err != GS_OK) ? err : GS_ERROR_IO;
+        }
+        done += block_sent;
+    }
+    return GS_OK;
+}
+
+static void tx_report_fec(const tx_stream_t *tx) {
+    if (!tx->fec || tx->fec_frames == 0) return;
+
+    log_info("FEC: %" PRIu32 " frames, %" PRIu32 " encode cycles/byte",
+             tx->fec_frames, tx->fec_cycles / (tx->fec_frames * FEC_DATA_SIZE));
+}
+
+static gs_error_t tx_append(tx_stream_t *tx, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    size_t remaining = len;
+
+    tx->planned += len;
+
+    while (remaining > 0) {
+        wdt_clear();
+
+        size_t space   = BLOCK_SIZE - tx->used;
+        size_t to_copy = (remaining < space) ? remaining : space;
+
+        memcpy(tx->buf + tx->used, p, to_copy);
+        tx->used  += to_copy;
+        p         += to_copy;
+        remaining -= to_copy;
+
+        if (tx->used == BLOCK_SIZE && tx->fec) {
+            gs_error_t err = tx_send_fec(tx);
+            if (err != GS_OK) return err;
+            tx->sent += BLOCK_SIZE;
+            tx->used  = 0;
+        } else if (tx->used == BLOCK_SIZE) {
+            size_t block_sent = 0;
+            gs_error_t err = gs_uart_write_buffer(USART1, 1000, tx->buf, BLOCK_SIZE, &block_sent);
+            if (err != GS_OK || block_sent == 0) {
+                log_error("UART write error at %u/%u planned bytes: %s (sent %u of 64)",
+                          (unsigned int)tx->sent,
+                          (unsigned int)tx->planned,
+                          gs_error_string(err),
+                          (unsigned int)block_sent);
+                return (err != GS_OK) ? err : GS_ERROR_IO;
+            }
+            tx->sent += block_sent;
+
+            if (block_sent < BLOCK_SIZE) {
+                memmove(tx->buf, tx->buf + block_sent, BLOCK_SIZE - block_sent);
+                tx->used = BLOCK_SIZE - block_sent;
+            } else {
+                tx->used = 0;
+            }
+        }
+
+        gs_time_sleep_ms(25); // pacing
+    }
+    return GS_OK;
+}
+
+static gs_error_t tx_flush(tx_stream_t *tx) {
+    if (tx->used == 0) return GS_OK;
+
+    if (tx->fec) {
+        // Zero pad; the ground drops the padding on packet CRC
+        size_t tail = tx->used;
+        memset(tx->buf + tail, 0, BLOCK_SIZE - tail);
+        gs_error_t err = tx_send_fec(tx);
+        if (err != GS_OK) return err;
+        tx->sent += tail;
+        tx->used  = 0;
+        return GS_OK;
+    }
+
+    size_t block_sent = 0;
+    gs_error_t err = gs_uart_write_buffer(USART1, 1000, tx->buf, tx->used, &block_sent);
+    if (err != GS_OK || block_sent == 0) {
+        log_error("UART tail flush error: %s (wanted %u, sent %u)",
+                  gs_error_string(err),
+                  (unsigned int)tx->used,
+                  (unsigned int)block_sent);
+        return (err != GS_OK) ? err : GS_ERROR_IO;
+    }
+    tx->sent += block_sent;
+
+    if (block_sent < tx->used) {
+        memmove(tx->buf, tx->buf + block_sent, tx->used - block_sent);
+    }
+    tx->used = (block_sent < tx->used) ? (tx->used - block_sent) : 0;
+    return GS_OK;
+}
+
+// Read window position i and append it if its CRC checks out
+static gs_error_t send_ring_packet(tx_stream_t *tx, uint32_t start_idx, uint32_t i, int *valid_count) {
+    uint32_t pkt_idx = (start_idx + i) % RING_CAP_PACKETS;
+    uint32_t offset  = pkt_idx * PKT_SIZE;
+    void *read_addr  = (uint8_t *)RADFET_FLASH_START + offset;
+
+    radfet_packet_t pkt;
+    gs_error_t err = gs_mcu_flash_read_data(&pkt, read_addr, PKT_SIZE);
+    if (err != GS_OK) {
+        log_error("Flash read failed @ offset %u: %s",
+                  (unsigned)offset, gs_error_string(err));
+        return GS_OK;
+    }
+
+    uint16_t crc = crc16_ccitt(&pkt, PKT_SIZE - sizeof(pkt.crc16));
+    if (crc != pkt.crc16) {
+        log_error("Skipping invalid packet @ offset %u (CRC mismatch)", (unsigned)offset);
+        return GS_OK;
+    }
+
+    (*valid_count)++;
+    return tx_append(tx, &pkt, PKT_SIZE);
+}
+
+// Stream the most recent ring samples. Linear mode goes oldest-to-newest.
+// Progressive mode sends every PROG_MAX_STRIDE-th sample first, then halves
+// the stride each pass, sending only positions not covered by a coarser
+// pass, so a truncated contact still spans the whole window. Each sample
+// is sent exactly once; the ground merges passes by index.
+static void downlink_ring(bool progressive) {
+    gs_error_t err = GS_OK;
+
+    // Clamp available samples to ring capacity
+    uint32_t available = (radfet_metadata.samples_saved < RING_CAP_PACKETS)
+                           ? radfet_metadata.samples_saved
+                           : RING_CAP_PACKETS;
+    uint32_t num_to_send = (available < NUM_SAMPLES_TO_SEND)
+                             ? available
+                             : NUM_SAMPLES_TO_SEND;
+
+    log_info("%s received: sending up to %" PRIu32 " samples from internal flash",
+             progressive ? "STX_PROG" : "STX", num_to_send);
+    uint32_t start_time = gs_time_rel_ms();
+
+    tx_stream_t tx;
+    tx_init(&tx, true);
+    int valid_sample_count = 0;
+
+    // normalize writer
+    uint32_t write_idx = (radfet_metadata.flash_write_offset / PKT_SIZE) % RING_CAP_PACKETS;
+    uint32_t start_idx = (write_idx + RING_CAP_PACKETS - num_to_send) % RING_CAP_PACKETS;
+
+    if (!progressive) {
+        for (uint32_t i = 0; i < num_to_send && err == GS_OK; i++) {
+            err = send_ring_packet(&tx, start_idx, i, &valid_sample_count);
+        }
+    } else {
+        for (uint32_t stride = PROG_MAX_STRIDE; stride > 0 && err == GS_OK; stride /= 2) {
+            for (uint32_t i = 0; i < num_to_send && err == GS_OK; i += stride) {
+                if (stride != PROG_MAX_STRIDE && (i % (2 * stride)) == 0) continue;  // sent by coarser pass
+                err = send_ring_packet(&tx, start_idx, i, &valid_sample_count);
+            }
+            log_info("Stride %" PRIu32 " pass done: %d samples, %u bytes",
+                     stride, valid_sample_count, (unsigned int)tx.planned);
+        }
+    }
+
+    if (err == GS_OK) {
+        err = tx_flush(&tx);
+    }
+
+    if (err == GS_OK && tx.sent == tx.planned) {
+        log_info("Downlink complete: %d valid samples, %u bytes sent in 64-byte blocks",
+                 valid_sample_count, (unsigned int)tx.sent);
+    } else {
+        log_error("Downlink incomplete: sent %u of %u bytes (%d valid samples)",
+                  (unsigned int)tx.sent,
+                  (unsigned int)tx.planned,
+                  valid_sample_count);
+    }
+
+    tx_report_fec(&tx);
+
+    uint32_t total_elapsed = gs_time_diff_ms(start_time, gs_time_rel_ms());
+    log_info("Transmission took %u ms", (unsigned int)total_elapsed);
+}
+
+// Stream every valid event slot: header followed by its n_pre + n_post packets.
+// Slots go out in address order; the ground orders them by event_id.
+static void downlink_events(void) {
+    gs_error_t err = GS_OK;
+
+    log_info("EVT received: scanning %u event slots", (unsigned int)RADFET_EVENT_SLOTS);
+    uint32_t start_time = gs_time_rel_ms();
+
+    tx_stream_t tx;
+    tx_init(&tx, true);
+    int event_count = 0;
+
+    for (uint32_t slot = 0; slot < RADFET_EVENT_SLOTS && err == GS_OK; slot++) {
+        radfet_event_header_t hdr;
+        if (!radfet_event_read_header(slot, &hdr)) continue;
+
+        event_count++;
+        err = tx_append(&tx, &hdr, sizeof(hdr));
+
+        const uint8_t *pkt_addr = (const uint8_t *)RADFET_EVENT_SLOT_ADDR(slot) + sizeof(hdr);
+        uint32_t n_pkts = (uint32_t)hdr.n_pre + hdr.n_post;
+
+        for (uint32_t i = 0; i < n_pkts && err == GS_OK; i++) {
+            radfet_packet_t pkt;
+            if (gs_mcu_flash_read_data(&pkt, pkt_addr + i * PKT_SIZE, PKT_SIZE) != GS_OK) {
+                // keep framing: ground drops the zeroed packet on CRC
+                memset(&pkt, 0, sizeof(pkt));
+                log_error("Event %" PRIu32 " packet %" PRIu32 " read failed", hdr.event_id, i);
+            }
+            err = tx_append(&tx, &pkt, PKT_SIZE);
+        }
+    }
+
+    if (err == GS_OK) {
+        err = tx_flush(&tx);
+    }
+
+    if (err == GS_OK && tx.sent == tx.planned) {
+        log_info("Event downlink complete: %d events, %u bytes sent",
+                 event_count, (unsigned int)tx.sent);
+    } else {
+        log_error("Event downlink incomplete: sent %u of %u bytes (%d events)",
+                  (unsigned int)tx.sent, (unsigned int)tx.planned, event_count);
+    }
+
+    tx_report_fec(&tx);
+
+    uint32_t total_elapsed = gs_time_diff_ms(start_time, gs_time_rel_ms());
+    log_info("Transmission took %u ms", (unsigned int)total_elapsed);
+}
+
+// Read a 2-byte command argument, high byte first
+static gs_error_t read_u16_arg(uint16_t *value) {
+    uint8_t hi, lo;
+    gs_error_t err = gs_uart_read(USART1, 1000, &hi);
+    if (err == GS_OK) err = gs_uart_read(USART1, 1000, &lo);
+    if (err != GS_OK) {
+        log_error("Missing command argument: %s", gs_error_string(err));
+        return err;
+    }
+    *value = (uint16_t)((hi << 8) | lo);
+    return GS_OK;
+}
+
+// Single status byte for a DIGEST / PAGE query that cannot be answered
+static void send_nak(const char *cmd, uint16_t arg) {
+    uint8_t nak = RADFET_REPLY_NAK;
+    size_t sent = 0;
+    gs_error_t err = gs_uart_write_buffer(USART1, 1000, &nak, 1, &sent);
+    log_error("%s: NAK for %u%s", cmd, arg, (err != GS_OK || sent != 1) ? " (send failed)" : "");
+}
+
+// Reply with ACK, then one digest tree node and its two children
+static void downlink_digest(uint16_t node) {
+    radfet_digest_reply_t reply;
+    if (!radfet_digest_node(node, &reply)) {
+        log_error("DIGEST: node %u out of range or tree not ready", node);
+        send_nak("DIGEST", node);
+        return;
+    }
+
+    uint8_t ack = RADFET_REPLY_ACK;
+    tx_stream_t tx;
+    tx_init(&tx, false);
+    gs_error_t err = tx_append(&tx, &ack, sizeof(ack));
+    if (err == GS_OK) err = tx_append(&tx, &reply, sizeof(reply));
+    if (err == GS_OK) err = tx_flush(&tx);
+
+    if (err != GS_OK) {
+        log_error("DIGEST: reply for node %u failed: %s", node, gs_error_string(err));
+    } else {
+        log_info("DIGEST: node %u = 0x%04X", node, reply.digest);
+    }
+}
+
+// Reply with ACK, the page index and current digest, then the raw page.
+// The page is read up front so a flash error can still be NAKed; the buffer
+// is static to keep 512 bytes off this task's stack (only this task calls it).
+static void downlink_page(uint16_t page) {
+    radfet_digest_reply_t leaf;
+    if (page >= RADFET_DIGEST_LEAVES || !radfet_digest_node(RADFET_DIGEST_LEAVES + page, &leaf)) {
+        log_error("PAGE: page %u out of range or tree not ready", page);
+        send_nak("PAGE", page);
+        return;
+    }
+
+    static uint8_t data[RADFET_DIGEST_PAGE_SIZE];
+    const uint8_t *addr = (const uint8_t *)RADFET_FLASH_START + (uint32_t)page * RADFET_DIGEST_PAGE_SIZE;
+    gs_error_t err = gs_mcu_flash_read_data(data, addr, sizeof(data));
+    if (err != GS_OK) {
+        log_error("PAGE: flash read failed @ page %u: %s", page, gs_error_string(err));
+        send_nak("PAGE", page);
+        return;
+    }
+
+    uint8_t ack = RADFET_REPLY_ACK;
+    radfet_page_header_t hdr = { .page = page, .digest = leaf.digest };
+
+    tx_stream_t tx;
+    tx_init(&tx, false);
+    err = tx_append(&tx, &ack, sizeof(ack));
+    if (err == GS_OK) err = tx_append(&tx, &hdr, sizeof(hdr));
+    if (err == GS_OK) err = tx_append(&tx, data, sizeof(data));
+    if (err == GS_OK) err = tx_flush(&tx);
+
+    if (err != GS_OK) {
+        log_error("PAGE: page %u incomplete: sent %u of %u bytes",
+                  page, (unsigned int)tx.sent, (unsigned int)tx.planned);
+    } else {
+        log_info("PAGE: page %u sent (digest 0x%04X)", page, hdr.digest);
+    }
+}
+
+// Reply with the routine-sample settle telemetry
+static void downlink_settle(void) {
+    radfet_settle_stats_t stats;
+    radfet_settle_get_stats(&stats);
+
+    tx_stream_t tx;
+    tx_init(&tx, false);
+    gs_error_t err = tx_append(&tx, &stats, sizeof(stats));
+    if (err == GS_OK) err = tx_flush(&tx);
+
+    if (err != GS_OK) {
+        log_error("SETTLE: reply failed: %s", gs_error_string(err));
+    } else {
+        log_info("SETTLE: last %u/%u ms, max %u ms, %" PRIu32 " settles, %" PRIu32 " capped",
+                 stats.last_ms[0], stats.last_ms[1], stats.max_ms, stats.count, stats.capped);
+    }
+}
+
+// Apply new event trigger settings; rejected as a whole if any is out of range
+static void configure_events(void) {
+    uint16_t rate_ms, delta, abs_counts;
+    if (read_u16_arg(&rate_ms) != GS_OK ||
+        read_u16_arg(&delta) != GS_OK ||
+        read_u16_arg(&abs_counts) != GS_OK) {
+        return;
+    }
+
+    if (rate_ms < RADFET_EVENT_MIN_RATE_MS || (delta == 0 && abs_counts == 0)) {
+        log_error("EVT_CFG rejected: rate %u ms (min %u), delta %u, abs %u",
+                  rate_ms, (unsigned int)RADFET_EVENT_MIN_RATE_MS, delta, abs_counts);
+        return;
+    }
+
+    radfet_event_config.rate_ms      = rate_ms;
+    radfet_event_config.delta_counts = delta;
+    radfet_event_config.abs_counts   = abs_counts;
+    log_info("Event trigger: rate %u ms, delta %u, abs %u", rate_ms, delta, abs_counts);
+}
+
 static void * task_mode_op(void * param) {
     log_info("Operation Modes initialization complete");
 
@@ -47,125 +456,43 @@ static void * task_mode_op(void * param) {
             log_info("Received byte on USART1: 0x%02X", incoming_byte);
 
             switch (incoming_byte) {
-                case STX: {
-                    // Clamp available samples to ring capacity
-                    uint32_t available = (radfet_metadata.samples_saved < RING_CAP_PACKETS)
-                                           ? radfet_metadata.samples_saved
-                                           : RING_CAP_PACKETS;
-                    uint32_t num_to_send = (available < NUM_SAMPLES_TO_SEND)
-                                             ? available
-                                             : NUM_SAMPLES_TO_SEND;
-
-                    log_info("STX received: sending up to %" PRIu32 " samples from internal flash", num_to_send);
-                    uint32_t start_time = gs_time_rel_ms();
-
-                    // staging buffer
-                    uint8_t txbuf[BLOCK_SIZE];
-                    size_t buf_used = 0;
-                    size_t total_bytes_planned = 0;
-                    size_t total_bytes_sent = 0;
-                    int valid_sample_count = 0;
-
-                    // normalize writer
-                    uint32_t write_idx = (radfet_metadata.flash_write_offset / PKT_SIZE) % RING_CAP_PACKETS;
-                    uint32_t start_idx = (write_idx + RING_CAP_PACKETS - num_to_send) % RING_CAP_PACKETS;
-
-                    for (uint32_t i = 0; i < num_to_send; i++) {
-                        uint32_t pkt_idx = (start_idx + i) % RING_CAP_PACKETS;
-                        uint32_t offset  = pkt_idx * PKT_SIZE;
-                        void *read_addr  = (uint8_t *)RADFET_FLASH_START + offset;
-
-                        radfet_packet_t pkt;
-                        err = gs_mcu_flash_read_data(&pkt, read_addr, PKT_SIZE);
-                        if (err != GS_OK) {
-                            log_error("Flash read failed @ offset %u: %s",
-                                      (unsigned)offset, gs_error_string(err));
-                            continue;
-                        }
-
-                        uint16_t crc = crc16_ccitt(&pkt, PKT_SIZE - sizeof(pkt.crc16));
-                        if (crc != pkt.crc16) {
-                            log_error("Skipping invalid packet @ offset %u (CRC mismatch)", (unsigned)offset);
-                            continue;
-                        }
-
-                        valid_sample_count++;
-                        total_bytes_planned += PKT_SIZE;
-
-                        // append into tx buffer
-                        const uint8_t *p = (const uint8_t *)&pkt;
-                        size_t remaining = PKT_SIZE;
-
-                        while (remaining > 0) {
-                            wdt_clear();
-
-                            size_t space   = BLOCK_SIZE - buf_used;
-                            size_t to_copy = (remaining < space) ? remaining : space;
-
-                            memcpy(txbuf + buf_used, p, to_copy);
-                            buf_used  += to_copy;
-                            p         += to_copy;
-                            remaining -= to_copy;
-
-                            if (buf_used == BLOCK_SIZE) {
-                                size_t block_sent = 0;
-                                err = gs_uart_write_buffer(USART1, 1000, txbuf, BLOCK_SIZE, &block_sent);
-                                if (err != GS_OK || block_sent == 0) {
-                                    log_error("UART write error at %u/%u planned bytes: %s (sent %u of 64)",
-                                              (unsigned int)total_bytes_sent,
-                                              (unsigned int)total_bytes_planned,
-                                              gs_error_string(err),
-                                              (unsigned int)block_sent);
-                                    goto TX_FINISH;
-                                }
-                                total_bytes_sent += block_sent;
-
-                                if (block_sent < BLOCK_SIZE) {
-                                    memmove(txbuf, txbuf + block_sent, BLOCK_SIZE - block_sent);
-                                    buf_used = BLOCK_SIZE - block_sent;
-                                } else {
-                                    buf_used = 0;
-                                }
-                            }
-
-                            gs_time_sleep_ms(25); // pacing
-                        }
-                    }
-
-                    // flush tail
-                    if (buf_used > 0) {
-                        size_t block_sent = 0;
-                        err = gs_uart_write_buffer(USART1, 1000, txbuf, buf_used, &block_sent);
-                        if (err != GS_OK || block_sent == 0) {
-                            log_error("UART tail flush error: %s (wanted %u, sent %u)",
-                                      gs_error_string(err),
-                                      (unsigned int)buf_used,
-                                      (unsigned int)block_sent);
-                            goto TX_FINISH;
-                        }
-                        total_bytes_sent += block_sent;
-
-                        if (block_sent < buf_used) {
-                            memmove(txbuf, txbuf + block_sent, buf_used - block_sent);
-                        }
-                        buf_used = (block_sent < buf_used) ? (buf_used - block_sent) : 0;
+                case STX:
+                    downlink_ring(false);
+                    break;
+                case STX_PROG:
+                    downlink_ring(true);
+                    break;
+                case EVT:
+                    downlink_events();
+                    break;
+                case FEC_ON:
+                case FEC_OFF:
+                    fec_enabled = (incoming_byte == FEC_ON);
+                    log_info("Downlink FEC %s", fec_enabled ? "enabled" : "disabled");
+                    break;
+                case EVT_ON:
+                case EVT_OFF:
+                    radfet_event_config.enabled = (incoming_byte == EVT_ON);
+                    log_info("Event capture %s", radfet_event_config.enabled ? "enabled" : "disabled");
+                    break;
+                case EVT_CFG:
+                    configure_events();
+                    break;
+                case SETTLE:
+                    downlink_settle();
+                    break;
+                case DIGEST:
+                case PAGE: {
+                    uint16_t arg;
+                    if (read_u16_arg(&arg) != GS_OK) {
+                        send_nak(incoming_byte == DIGEST ? "DIGEST" : "PAGE", 0);
+                        break;
                     }
-
-                    err = GS_OK;
-
-                TX_FINISH:
-                    if (err == GS_OK && total_bytes_sent == total_bytes_planned) {
-                        log_info("Downlink complete: %d valid samples, %u bytes sent in 64-byte blocks",
-                                 valid_sample_count, (unsigned int)total_bytes_sent);
+                    if (incoming_byte == DIGEST) {
+                        downlink_digest(arg);
                     } else {
-                        log_error("Downlink incomplete: sent %u of %u bytes (%d valid samples)",
-                                  (unsigned int)total_bytes_sent,
-                                  (unsigned int)total_bytes_planned,
-                                  valid_sample_count);
+                        downlink_page(arg);
                     }
-
-                    uint32_t total_elapsed = gs_time_diff_ms(start_time, gs_time_rel_ms());
-                    log_info("Transmission took %u ms", (unsigned int)total_elapsed);
                     break;
                 }
                 default:
@@ -184,6 +511,8 @@ static void * task_mode_op(void * param) {
 void mode_op_init(void) {
     log_info("Operation Modes initialization");
 
+    fec_init();
+
     gs_uart_config_t uart_conf;
     gs_uart_get_default_config(&uart_conf);
     uart_conf.comm.bps = 57600;
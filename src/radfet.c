@@ -3,6 +3,8 @@ RADFET Data Collection:
 - Enabling sensors through tca9539 I2C to i/o converter
 - Polling using ADC Channels
 - Saving sample packets to internal flash (circular buffer)
+- High-rate readouts between samples feed the event trigger when enabled (radfet_event.c)
+- Keeping the ring digest tree current (radfet_digest.c)
 - Put task to sleep per sample rate
 */
 
@@ -14,11 +16,13 @@ RADFET Data Collection:
 #include <gs/util/types.h>
 #include <gs/util/vmem.h>
 #include <gs/util/log.h>
+#include <gs/util/mutex.h>
 #include <wdt.h>
 #include <gs/util/drivers/i2c/master.h>
 #include <inttypes.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include "radfet.h"
 #include <gs/thirdparty/flash/spn_fl512s.h>
 #include <gs/embed/drivers/flash/mcu_flash.h>
@@ -32,15 +36,29 @@ static inline int ring_capacity_ok(void) {
     return (RING_CAP_PACKETS > 0);
 }
 
-// ADC RADFET pin configuration
+// ADC RADFET pin configuration (from RADFET_SENSOR_TABLE)
+#define RADFET_CH_TERM(a, mod, ch, exp, en, r1, r2)  [mod] = ch,
 static const uint8_t radfet_channels[NUM_RADFET] = {
-    7,  // D1 → AD7
-    6,  // D2 → AD6
-    5,  // D3 → AD5
-    4,  // D4 → AD4
-    0   // D5 → AD0
+    RADFET_SENSOR_TABLE(RADFET_CH_TERM, 0)
 };
 
+// Per-expander bias masks, resolved at compile time
+typedef struct {
+    uint8_t  addr;
+    uint16_t en;                      // CTRL lines
+    uint16_t r[RADFET_PER_MODULE];    // R1 / R2 lines
+} radfet_expander_t;
+
+#define RADFET_EXPANDER_ENTRY(a, addr) \
+    { (addr), RADFET_EN_MASK(addr), { RADFET_R1_MASK(addr), RADFET_R2_MASK(addr) } },
+static const radfet_expander_t radfet_expanders[] = {
+    RADFET_EXPANDER_TABLE(RADFET_EXPANDER_ENTRY, 0)
+};
+#define NUM_EXPANDERS  (sizeof(radfet_expanders) / sizeof(radfet_expanders[0]))
+
+// I2C transactions issued by the helpers below (logged per sample)
+static uint32_t i2c_transactions = 0;
+
 // Global metadata (persisted in flash via load/save helpers)
 radfet_metadata_t radfet_metadata = {
     .flash_write_offset = 0,
@@ -50,61 +68,76 @@ radfet_metadata_t radfet_metadata = {
 };
 
 // ===== TCA9539 helpers =====
-static inline gs_error_t write_tca9539_register(uint8_t reg, uint8_t value) {
-    uint8_t tx[2] = {reg, value};
-    return gs_i2c_master_transaction(0, TCA9539_I2C_ADDR, tx, 2, NULL, 0, I2C_TIMEOUT_MS);
+// Port 0/1 registers form pairs; the TCA9539 auto-increments within a pair,
+// so both ports are written or read in a single transaction.
+static inline gs_error_t write_tca9539_pair(uint8_t addr, uint8_t reg, uint16_t value) {
+    uint8_t tx[3] = {reg, (uint8_t)(value & 0xFF), (uint8_t)(value >> 8)};
+    i2c_transactions++;
+    return gs_i2c_master_transaction(0, addr, tx, 3, NULL, 0, I2C_TIMEOUT_MS);
 }
 
-static inline gs_error_t read_tca9539_register(uint8_t reg, uint8_t *value) {
-    return gs_i2c_master_transaction(0, TCA9539_I2C_ADDR, &reg, 1, value, 1, I2C_TIMEOUT_MS);
+static inline gs_error_t read_tca9539_pair(uint8_t addr, uint8_t reg, uint16_t *value) {
+    uint8_t rx[2] = {0, 0};
+    i2c_transactions++;
+    gs_error_t err = gs_i2c_master_transaction(0, addr, &reg, 1, rx, 2, I2C_TIMEOUT_MS);
+    *value = (uint16_t)(rx[0] | (rx[1] << 8));
+    return err;
 }
 
-// Write both OUT ports (preserves first error if both fail)
-static gs_error_t update_io_expander(uint8_t port0, uint8_t port1) {
-    gs_error_t err0 = write_tca9539_register(TCA9539_OUT_PORT0, port0);
-    gs_error_t err1 = write_tca9539_register(TCA9539_OUT_PORT1, port1);
-    return (err0 != GS_OK) ? err0 : err1;
+// Write both OUT ports of one expander, optionally verifying by read-back
+static gs_error_t update_io_expander(const radfet_expander_t *exp, uint16_t out) {
+    gs_error_t err = write_tca9539_pair(exp->addr, TCA9539_OUT_PORT0, out);
+    if (err != GS_OK) return err;
+
+#if RADFET_IO_VERIFY
+    uint16_t readback;
+    if ((err = read_tca9539_pair(exp->addr, TCA9539_OUT_PORT0, &readback)) != GS_OK) {
+        log_error("Failed to read OUT ports @ 0x%02X: %s", exp->addr, gs_error_string(err));
+        return err;
+    }
+    if (readback != out) {
+        log_error("OUT ports @ 0x%02X = 0x%04X, expected 0x%04X", exp->addr, readback, out);
+        return GS_ERROR_IO;
+    }
+#endif
+    return GS_OK;
 }
 
 static gs_error_t tca9539_config(void) {
     gs_error_t err;
-    err = write_tca9539_register(TCA9539_OUT_PORT0, 0x00);
-    if (err != GS_OK) { log_error("Failed to write OUT_PORT0: %s", gs_error_string(err)); return err; }
-
-    err = write_tca9539_register(TCA9539_OUT_PORT1, 0x00);
-    if (err != GS_OK) { log_error("Failed to write OUT_PORT1: %s", gs_error_string(err)); return err; }
 
-    err = write_tca9539_register(TCA9539_CFG_PORT0, 0x00);
-    if (err != GS_OK) { log_error("Failed to write CFG_PORT0: %s", gs_error_string(err)); return err; }
+    for (size_t e = 0; e < NUM_EXPANDERS; e++) {
+        uint8_t addr = radfet_expanders[e].addr;
 
-    err = write_tca9539_register(TCA9539_CFG_PORT1, 0x00);
-    if (err != GS_OK) { log_error("Failed to write CFG_PORT1: %s", gs_error_string(err)); return err; }
+        err = write_tca9539_pair(addr, TCA9539_OUT_PORT0, 0x0000);
+        if (err != GS_OK) { log_error("Failed to write OUT ports @ 0x%02X: %s", addr, gs_error_string(err)); return err; }
 
-    uint8_t cfg0, cfg1, out0, out1;
+        err = write_tca9539_pair(addr, TCA9539_CFG_PORT0, 0x0000);
+        if (err != GS_OK) { log_error("Failed to write CFG ports @ 0x%02X: %s", addr, gs_error_string(err)); return err; }
 
-    err = read_tca9539_register(TCA9539_CFG_PORT0, &cfg0);
-    if (err != GS_OK) { log_error("Failed to read CFG_PORT0: %s", gs_error_string(err)); return err; }
-    log_info("CFG_PORT0 = 0x%02X → %s", cfg0, (cfg0 == 0x00) ? "OK (all outputs)" : "NOT OK");
+        uint16_t cfg, out;
 
-    err = read_tca9539_register(TCA9539_CFG_PORT1, &cfg1);
-    if (err != GS_OK) { log_error("Failed to read CFG_PORT1: %s", gs_error_string(err)); return err; }
-    log_info("CFG_PORT1 = 0x%02X → %s", cfg1, (cfg1 == 0x00) ? "OK (all outputs)" : "NOT OK");
+        err = read_tca9539_pair(addr, TCA9539_CFG_PORT0, &cfg);
+        if (err != GS_OK) { log_error("Failed to read CFG ports @ 0x%02X: %s", addr, gs_error_string(err)); return err; }
+        log_info("0x%02X CFG_PORT0/1 = 0x%02X/0x%02X → %s", addr, cfg & 0xFF, cfg >> 8,
+                 (cfg == 0x0000) ? "OK (all outputs)" : "NOT OK");
 
-    err = read_tca9539_register(TCA9539_OUT_PORT0, &out0);
-    if (err != GS_OK) { log_error("Failed to read OUT_PORT0: %s", gs_error_string(err)); return err; }
-    log_info("OUT_PORT0 = 0x%02X", out0);
-
-    err = read_tca9539_register(TCA9539_OUT_PORT1, &out1);
-    if (err != GS_OK) { log_error("Failed to read OUT_PORT1: %s", gs_error_string(err)); return err; }
-    log_info("OUT_PORT1 = 0x%02X", out1);
+        err = read_tca9539_pair(addr, TCA9539_OUT_PORT0, &out);
+        if (err != GS_OK) { log_error("Failed to read OUT ports @ 0x%02X: %s", addr, gs_error_string(err)); return err; }
+        log_info("0x%02X OUT_PORT0/1 = 0x%02X/0x%02X", addr, out & 0xFF, out >> 8);
+    }
 
     return GS_OK;
 }
 
 // ===== CRC16-CCITT (0x1021, init 0xFFFF, no xorout) =====
 uint16_t crc16_ccitt(const void *data, size_t length) {
+    return crc16_ccitt_update(0xFFFF, data, length);
+}
+
+// Continue a CRC over further bytes (for data read in chunks)
+uint16_t crc16_ccitt_update(uint16_t crc, const void *data, size_t length) {
     const uint8_t *bytes = (const uint8_t *)data;
-    uint16_t crc = 0xFFFF;
     for (size_t i = 0; i < length; i++) {
         crc ^= (uint16_t)bytes[i] << 8;
         for (int j = 0; j < 8; j++) {
@@ -164,6 +197,10 @@ gs_error_t radfet_save_metadata(void) {
     return gs_mcu_flash_write_data(RADFET_METADATA_ADDR, (uint8_t *)&meta, METADATA_PKT_SIZE);
 }
 
+// Settle telemetry over routine samples only; read via radfet_settle_get_stats()
+static radfet_settle_stats_t settle_stats;
+static gs_mutex_t            settle_lock = NULL;
+
 // ===== ADC sampling helpers =====
 static gs_error_t radfet_read_all(radfet_sample_t *sample, int r) {
     int16_t all_adc_values[GS_A3200_ADC_NCHANS] = {0};
@@ -182,52 +219,166 @@ static gs_error_t radfet_read_all(radfet_sample_t *sample, int r) {
     return GS_OK;
 }
 
-static gs_error_t radfet_enable_all(int r) {
-    uint8_t port0 = 0;
-    uint8_t port1 = 0;
-
-    // Enable CTRL for all 5 dosimeters
-    port0 |= (P00_D3_EN | P06_D1_EN | P03_D2_EN);
-    port1 |= (P15_D4_EN | P12_D5_EN);
-
-    // Choose R1 or R2 lines
-    if (r == 0) {
-        port0 |= (P01_D3_R1 | P07_D1_R1 | P04_D2_R1);
-        port1 |= (P14_D4_R1 | P11_D5_R1);
-    } else if (r == 1) {
-        port0 |= (P05_D1_R2 | P02_D2_R2);
-        port1 |= (P17_D3_R2 | P16_D4_R2 | P13_D5_R2);
-    } else {
+// Wait for the biased channels to settle; returns the time taken
+static uint16_t radfet_settle(void) {
+    uint32_t start = gs_time_rel_ms();
+    uint32_t elapsed;
+
+#if RADFET_SETTLE_ADAPTIVE
+    int16_t prev[GS_A3200_ADC_NCHANS] = {0};
+    int16_t cur[GS_A3200_ADC_NCHANS]  = {0};
+    int quiet = 0;
+    bool have_prev = (gs_a3200_adc_channels_sample(prev) == GS_OK);
+
+    for (;;) {
+        gs_time_sleep_ms(RADFET_SETTLE_STEP_MS);
+        elapsed = gs_time_diff_ms(start, gs_time_rel_ms());
+        if (elapsed >= RADFET_SETTLE_MAX_MS) break;
+
+        if (gs_a3200_adc_channels_sample(cur) != GS_OK) {
+            have_prev = false;
+            quiet = 0;
+            continue;
+        }
+
+        int max_step = 0;
+        for (int i = 0; i < NUM_RADFET; i++) {
+            uint8_t ch = radfet_channels[i];
+            int step = abs((int)cur[ch] - prev[ch]);
+            if (step > max_step) max_step = step;
+        }
+        memcpy(prev, cur, sizeof(prev));
+
+        quiet = (have_prev && max_step <= RADFET_SETTLE_SLOPE_COUNTS) ? quiet + 1 : 0;
+        have_prev = true;
+
+        if (quiet >= RADFET_SETTLE_QUIET_STEPS && elapsed >= RADFET_SETTLE_MIN_MS) break;
+    }
+#else
+    // 200 ms based on Varadis guidance to allow voltages to settle
+    gs_time_sleep_ms(RADFET_SETTLE_MAX_MS);
+#endif
+
+    elapsed = gs_time_diff_ms(start, gs_time_rel_ms());
+    return (elapsed > UINT16_MAX) ? UINT16_MAX : (uint16_t)elapsed;
+}
+
+static void radfet_settle_record(const uint16_t settle_ms[RADFET_PER_MODULE]) {
+    if (settle_lock) gs_mutex_lock(settle_lock);
+    for (int r = 0; r < RADFET_PER_MODULE; r++) {
+        uint16_t ms = settle_ms[r];
+        settle_stats.last_ms[r] = ms;
+        if (ms > settle_stats.max_ms) settle_stats.max_ms = ms;
+        if (ms >= RADFET_SETTLE_MAX_MS) settle_stats.capped++;
+        settle_stats.total_ms += ms;
+        settle_stats.count++;
+    }
+    if (settle_lock) gs_mutex_unlock(settle_lock);
+}
+
+void radfet_settle_get_stats(radfet_settle_stats_t *out) {
+    if (settle_lock) gs_mutex_lock(settle_lock);
+    *out = settle_stats;
+    if (settle_lock) gs_mutex_unlock(settle_lock);
+
+    out->crc16 = crc16_ccitt(out, sizeof(*out) - sizeof(out->crc16));
+}
+
+static gs_error_t radfet_enable_all(int r, uint16_t *settle_ms) {
+    if (r < 0 || r >= RADFET_PER_MODULE) {
         log_error("Invalid RADFET mode: %d", r);
         return GS_ERROR_ARG;
     }
 
-    gs_error_t err = update_io_expander(port0, port1);
-    if (err != GS_OK) {
-        log_error("Failed to update I2C I/O Expander: %s", gs_error_string(err));
-        return err;
+    // Enable CTRL for all dosimeters plus the chosen R1 or R2 lines
+    for (size_t e = 0; e < NUM_EXPANDERS; e++) {
+        const radfet_expander_t *exp = &radfet_expanders[e];
+        uint16_t out = exp->en | exp->r[r];
+
+        gs_error_t err = update_io_expander(exp, out);
+        if (err != GS_OK) {
+            log_error("Failed to update I2C I/O Expander 0x%02X: %s", exp->addr, gs_error_string(err));
+            return err;
+        }
+        log_info("0x%02X OUT_PORT0/1 = 0x%02X/0x%02X", exp->addr, out & 0xFF, out >> 8);
     }
 
-    uint8_t out0, out1;
-    if ((err = read_tca9539_register(TCA9539_OUT_PORT0, &out0)) != GS_OK) {
-        log_error("Failed to read OUT_PORT0: %s", gs_error_string(err));
-        return err;
+    *settle_ms = radfet_settle();
+    return GS_OK;
+}
+
+static gs_error_t radfet_disable_all(void) {
+    gs_error_t first = GS_OK;
+    for (size_t e = 0; e < NUM_EXPANDERS; e++) {
+        gs_error_t err = update_io_expander(&radfet_expanders[e], 0);
+        if (first == GS_OK) first = err;   // preserve first error, still disable the rest
     }
-    log_info("OUT_PORT0 = 0x%02X", out0);
+    return first;
+}
 
-    if ((err = read_tca9539_register(TCA9539_OUT_PORT1, &out1)) != GS_OK) {
-        log_error("Failed to read OUT_PORT1: %s", gs_error_string(err));
-        return err;
+// One full R1 + R2 readout of all dosimeters. Returns the first bias or ADC
+// error; the sample then holds zeros for the failed phase and must not be
+// treated as a measurement. Only routine readouts feed the settle telemetry.
+static gs_error_t radfet_acquire(radfet_sample_t *sample, bool routine) {
+    gs_error_t err;
+    gs_error_t result = GS_OK;
+    uint32_t i2c_start = i2c_transactions;
+    uint16_t settle_ms[RADFET_PER_MODULE] = {0};
+
+    // R1 then R2
+    for (int r = 0; r < RADFET_PER_MODULE; r++) {
+        err = radfet_enable_all(r, &settle_ms[r]);
+        if (err == GS_OK) {
+            err = radfet_read_all(sample, r);
+            if (err != GS_OK) {
+                log_error("Failed to read R%d channels", r + 1);
+            }
+        } else {
+            log_error("Failed to enable sensors: %s", gs_error_string(err));
+        }
+        if (result == GS_OK) result = err;
+
+        err = radfet_disable_all();
+        if (err != GS_OK) {
+            log_error("Failed to disable sensors: %s", gs_error_string(err));
+        }
     }
-    log_info("OUT_PORT1 = 0x%02X", out1);
 
-    // 200 ms based on Varadis guidance to allow voltages to settle
-    gs_time_sleep_ms(200);
-    return GS_OK;
+    log_info("I2C transactions this readout: %" PRIu32, i2c_transactions - i2c_start);
+    log_info("Settle R1 = %u ms, R2 = %u ms", settle_ms[0], settle_ms[1]);
+
+    if (routine && result == GS_OK) {
+        radfet_settle_record(settle_ms);
+    }
+    return result;
 }
 
-static inline gs_error_t radfet_disable_all(void) {
-    return update_io_expander(0, 0);
+// Fill the gap until the next routine sample with high-rate readouts for the
+// event trigger while capture is enabled. Readouts are not written to the ring.
+static void radfet_event_wait(uint32_t cycle_start) {
+    uint32_t due = radfet_event_config.rate_ms;
+
+    while (due < radfet_metadata.sample_rate_ms && radfet_event_config.enabled) {
+        uint32_t elapsed = gs_time_diff_ms(cycle_start, gs_time_rel_ms());
+        if (elapsed < due) {
+            gs_time_sleep_ms(due - elapsed);
+        }
+        wdt_clear();
+
+        radfet_sample_t sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.index = radfet_metadata.samples_saved;
+        if (radfet_acquire(&sample, false) == GS_OK) {
+            radfet_event_feed(&sample);
+        }
+
+        due += radfet_event_config.rate_ms;
+    }
+
+    uint32_t elapsed = gs_time_diff_ms(cycle_start, gs_time_rel_ms());
+    if (elapsed < radfet_metadata.sample_rate_ms) {
+        gs_time_sleep_ms(radfet_metadata.sample_rate_ms - elapsed);
+    }
 }
 
 // ===== Main polling task =====
@@ -252,6 +403,10 @@ static void * radfet_poll_task(void * param) {
         log_info("Metadata successfully loaded in polling task");
     }
 
+    radfet_event_init();
+
+    radfet_digest_init();
+
     for (;;) {
         wdt_clear();
 
@@ -263,22 +418,7 @@ static void * radfet_poll_task(void * param) {
 
         log_info("=== RADFET Sample ===");
 
-        // R1 then R2
-        for (int r = 0; r < RADFET_PER_MODULE; r++) {
-            err = radfet_enable_all(r);
-            if (err == GS_OK) {
-                if (radfet_read_all(&pkt.sample, r) != GS_OK) {
-                    log_error("Failed to read R%d channels", r + 1);
-                }
-            } else {
-                log_error("Failed to enable sensors: %s", gs_error_string(err));
-            }
-
-            err = radfet_disable_all();
-            if (err != GS_OK) {
-                log_error("Failed to disable sensors: %s", gs_error_string(err));
-            }
-        }
+        gs_error_t acquire_err = radfet_acquire(&pkt.sample, true);
 
         // Write sample to internal flash (circular)
         // Normalize write offset for safety and guarantee alignment.
@@ -296,6 +436,11 @@ static void * radfet_poll_task(void * param) {
         pkt.crc16 = crc16_ccitt(&pkt, sizeof(pkt) - sizeof(pkt.crc16));
 
         err = gs_mcu_flash_write_data(target_addr, &pkt, sizeof(pkt));
+
+        // Rehash even on failure: a failed write may still have erased or
+        // partly programmed the page, and the leaf must match what is there
+        radfet_digest_update(offset, sizeof(pkt));
+
         if (err != GS_OK) {
             log_error("Failed to write to internal flash: %s", gs_error_string(err));
         } else {
@@ -315,7 +460,17 @@ static void * radfet_poll_task(void * param) {
         }
 
         log_info("==============================");
-        gs_time_sleep_ms(radfet_metadata.sample_rate_ms);
+
+        if (radfet_event_config.enabled) {
+            // A failed readout must not reach the trigger or become its reference
+            if (acquire_err == GS_OK) {
+                radfet_event_feed(&pkt.sample);
+            }
+            radfet_event_wait(gs_time_rel_ms());
+        } else {
+            radfet_event_reset();
+            gs_time_sleep_ms(radfet_metadata.sample_rate_ms);
+        }
     }
 
     gs_thread_exit(NULL);
@@ -333,6 +488,11 @@ void radfet_task_init(void) {
         log_error("Failed to initialize I2C I/O Converter");
     }
 
+    if (gs_mutex_create(&settle_lock) != GS_OK) {
+        log_error("Failed to create settle stats mutex");
+        settle_lock = NULL;
+    }
+
     gs_thread_create("radfet_poll", radfet_poll_task, NULL,
                      3000, GS_THREAD_PRIORITY_LOW, 0, NULL);
 }
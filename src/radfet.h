@@ -2,6 +2,7 @@
 #define RADFET_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>     // for size_t
 #include <avr32/io.h>
 
@@ -12,37 +13,49 @@
 #define TCA9539_OUT_PORT0  0x02
 #define TCA9539_OUT_PORT1  0x03
 
-// OUT_PORT0 bits (P00–P07)
-#define P00_D3_EN   (1u << 0)
-#define P01_D3_R1   (1u << 1)
-#define P02_D2_R2   (1u << 2)
-#define P03_D2_EN   (1u << 3)
-#define P04_D2_R1   (1u << 4)
-#define P05_D1_R2   (1u << 5)
-#define P06_D1_EN   (1u << 6)
-#define P07_D1_R1   (1u << 7)
-
-// OUT_PORT1 bits (P10–P17)
-#define P10_UNUSED  (1u << 0)
-#define P11_D5_R1   (1u << 1)
-#define P12_D5_EN   (1u << 2)
-#define P13_D5_R2   (1u << 3)
-#define P14_D4_R1   (1u << 4)
-#define P15_D4_EN   (1u << 5)
-#define P16_D4_R2   (1u << 6)
-#define P17_D3_R2   (1u << 7)
-
 #define I2C_TIMEOUT_MS  100
 
+// Read OUT ports back after every bias change (costs one extra I2C
+// transaction per expander per phase)
+#ifndef RADFET_IO_VERIFY
+#define RADFET_IO_VERIFY  0
+#endif
+
+// ---------- Sensor map ----------
+// One row per dosimeter module: X(arg, module, adc_ch, expander, en, r1, r2)
+// en/r1/r2 are expander pin numbers 0..15 (P00..P07 = 0..7, P10..P17 = 8..15).
+// Port masks, the ADC channel table and NUM_RADFET are generated from this.
+#define RADFET_SENSOR_TABLE(X, arg) \
+    X(arg, 0, 7, TCA9539_I2C_ADDR,  6,  7,  5)  /* D1: P06 EN, P07 R1, P05 R2 -> AD7 */ \
+    X(arg, 1, 6, TCA9539_I2C_ADDR,  3,  4,  2)  /* D2: P03 EN, P04 R1, P02 R2 -> AD6 */ \
+    X(arg, 2, 5, TCA9539_I2C_ADDR,  0,  1, 15)  /* D3: P00 EN, P01 R1, P17 R2 -> AD5 */ \
+    X(arg, 3, 4, TCA9539_I2C_ADDR, 13, 12, 14)  /* D4: P15 EN, P14 R1, P16 R2 -> AD4 */ \
+    X(arg, 4, 0, TCA9539_I2C_ADDR, 10,  9, 11)  /* D5: P12 EN, P11 R1, P13 R2 -> AD0 */
+
+// Every TCA9539 referenced above: X(arg, addr)
+#define RADFET_EXPANDER_TABLE(X, arg) \
+    X(arg, TCA9539_I2C_ADDR)
+
+#define RADFET_PIN_IF(exp, addr, pin)  (((exp) == (addr)) ? (uint16_t)(1u << (pin)) : 0u)
+#define RADFET_EN_TERM(a, mod, ch, exp, en, r1, r2)  | RADFET_PIN_IF(exp, a, en)
+#define RADFET_R1_TERM(a, mod, ch, exp, en, r1, r2)  | RADFET_PIN_IF(exp, a, r1)
+#define RADFET_R2_TERM(a, mod, ch, exp, en, r1, r2)  | RADFET_PIN_IF(exp, a, r2)
+#define RADFET_COUNT_TERM(a, mod, ch, exp, en, r1, r2)  + 1
+
+// 16-bit masks (low byte = OUT_PORT0, high byte = OUT_PORT1) for one expander
+#define RADFET_EN_MASK(addr)  (0u RADFET_SENSOR_TABLE(RADFET_EN_TERM, addr))
+#define RADFET_R1_MASK(addr)  (0u RADFET_SENSOR_TABLE(RADFET_R1_TERM, addr))
+#define RADFET_R2_MASK(addr)  (0u RADFET_SENSOR_TABLE(RADFET_R2_TERM, addr))
+
 // ---------- RADFET sampling/packet layout ----------
-#define NUM_RADFET         5      // D1..D5
+#define NUM_RADFET         (0 RADFET_SENSOR_TABLE(RADFET_COUNT_TERM, 0))   // D1..D5
 #define RADFET_PER_MODULE  2      // R1, R2
 
 typedef struct __attribute__((packed)) {
     // uint32_t timestamp;   // optional — only enable if reader/writer both expect it
     uint32_t index;                    // 4 bytes
-    int16_t  adc[NUM_RADFET][RADFET_PER_MODULE]; // 20 bytes
-} radfet_sample_t;                     // = 24 bytes
+    int16_t  adc[NUM_RADFET][RADFET_PER_MODULE]; // 20 bytes with 5 modules
+} radfet_sample_t;                     // = 24 bytes with 5 modules
 
 typedef struct __attribute__((packed)) {
     radfet_sample_t sample;  // 24
@@ -51,6 +64,43 @@ typedef struct __attribute__((packed)) {
 
 #define PKT_SIZE sizeof(radfet_packet_t)
 
+// ---------- Bias settle ----------
+// After biasing, enabled channels are polled every RADFET_SETTLE_STEP_MS and
+// declared settled once every channel moves by at most RADFET_SETTLE_SLOPE_COUNTS
+// per step for RADFET_SETTLE_QUIET_STEPS steps in a row. Never earlier than
+// the floor; the 200 ms Varadis figure is kept as the ceiling.
+// Accuracy trade-off: an RC settle still moving SLOPE counts per step is about
+// SLOPE * tau / STEP counts short of final. With the defaults that is a worst
+// case of ~5 counts at tau 20 ms vs 0.5 at a fixed 200 ms (ground_example.ipynb);
+// lower RADFET_SETTLE_SLOPE_COUNTS to buy accuracy with bias-on time.
+#ifndef RADFET_SETTLE_ADAPTIVE
+#define RADFET_SETTLE_ADAPTIVE      1
+#endif
+#ifndef RADFET_SETTLE_MIN_MS
+#define RADFET_SETTLE_MIN_MS        40
+#endif
+#define RADFET_SETTLE_MAX_MS        200
+#define RADFET_SETTLE_STEP_MS       10
+#ifndef RADFET_SETTLE_SLOPE_COUNTS
+#define RADFET_SETTLE_SLOPE_COUNTS  3
+#endif
+#ifndef RADFET_SETTLE_QUIET_STEPS
+#define RADFET_SETTLE_QUIET_STEPS   2
+#endif
+
+// Settle telemetry over routine samples (event readouts excluded),
+// downlinked by the SETTLE UART query
+typedef struct __attribute__((packed)) {
+    uint16_t last_ms[RADFET_PER_MODULE];   // most recent settle time, R1 / R2
+    uint16_t max_ms;                       // worst case since boot
+    uint32_t total_ms;                     // sum over all settles (avg = total_ms / count)
+    uint32_t count;
+    uint32_t capped;                       // settles that hit RADFET_SETTLE_MAX_MS
+    uint16_t crc16;                        // CRC over this struct excluding crc16
+} radfet_settle_stats_t;                   // = 22 bytes
+
+void radfet_settle_get_stats(radfet_settle_stats_t *out);
+
 // ---------- Metadata ----------
 typedef struct __attribute__((packed)) {
     uint32_t flash_write_offset;   // byte offset within data ring
@@ -65,21 +115,174 @@ extern radfet_metadata_t radfet_metadata;
 
 // ---------- Flash map ----------
 // Code region (per nanomind-bsp.map): 0x80000000 .. ~0x8002F798
-// Data ring lives here:
-#define RADFET_FLASH_START   ((void *) 0x80040000u)
-#define RADFET_FLASH_END     ((void *) 0x80080000u)     // exclusive end
+// Keep code below RADFET_CODE_LIMIT_ADDR; check the map after adding features.
+#define RADFET_CODE_LIMIT_ADDR   0x80038000u
+// Data ring lives here (raw addresses usable in #if):
+#define RADFET_FLASH_START_ADDR  0x80040000u
+#define RADFET_FLASH_END_ADDR    0x80080000u                    // exclusive end
+#define RADFET_FLASH_START   ((void *) RADFET_FLASH_START_ADDR)
+#define RADFET_FLASH_END     ((void *) RADFET_FLASH_END_ADDR)
 #define RADFET_FLASH_SIZE    ((uintptr_t)RADFET_FLASH_END - (uintptr_t)RADFET_FLASH_START)
 
 // Metadata lives outside the data ring
 #define RADFET_METADATA_ADDR ((void *)(0x80080000u + AVR32_FLASH_PAGE_SIZE))
 
+// ---------- Event capture ----------
+// While enabled, high-rate readouts are taken between routine samples and
+// kept in a RAM pre-trigger buffer. When a channel jumps by more than the
+// delta threshold (or rises through the absolute threshold), the pre-trigger
+// buffer plus RADFET_EVENT_POST_SAMPLES further readouts are frozen into the
+// event region. Off by default: every high-rate readout biases all sensors.
+#define RADFET_EVENT_RATE_MS        5000   // default high-rate readout period
+#define RADFET_EVENT_MIN_RATE_MS    1000   // a biased R1 + R2 readout takes up to ~0.5 s
+#define RADFET_EVENT_PRE_SAMPLES    16     // RAM pre-trigger depth
+#define RADFET_EVENT_POST_SAMPLES   16     // readouts captured after trigger
+#define RADFET_EVENT_DELTA_COUNTS   64     // default |adc - previous| that trips a trigger
+#define RADFET_EVENT_ABS_COUNTS     0      // default adc >= this trips a trigger (0 = disabled)
+
+// Runtime settings, changed over UART (EVT_ON / EVT_OFF / EVT_CFG)
+typedef struct {
+    bool     enabled;
+    uint16_t rate_ms;
+    uint16_t delta_counts;
+    uint16_t abs_counts;   // re-arms only after the channel drops back below it
+} radfet_event_config_t;
+
+extern radfet_event_config_t radfet_event_config;
+
+typedef struct __attribute__((packed)) {
+    uint32_t event_id;         // monotonically increasing, survives resets
+    uint32_t trigger_sample;   // radfet_metadata.samples_saved at trigger
+    uint32_t rate_ms;          // high-rate readout period used
+    uint16_t n_pre;            // valid pre-trigger packets (incl. trigger readout)
+    uint16_t n_post;           // valid post-trigger packets
+    uint8_t  trigger_module;   // 0..NUM_RADFET-1
+    uint8_t  trigger_r;        // 0 = R1, 1 = R2
+    int16_t  trigger_delta;    // adc - previous for the tripping channel
+    uint16_t crc16;            // CRC over this struct excluding crc16
+} radfet_event_header_t;       // = 22 bytes, followed by n_pre + n_post radfet_packet_t
+
+#define RADFET_EVENT_MAX_PACKETS  (RADFET_EVENT_PRE_SAMPLES + RADFET_EVENT_POST_SAMPLES)
+#define RADFET_EVENT_SLOT_SIZE    (sizeof(radfet_event_header_t) + RADFET_EVENT_MAX_PACKETS * sizeof(radfet_packet_t))
+
+// Event region sits between the code limit and the routine ring
+#define RADFET_EVENT_FLASH_ADDR   0x80038000u
+#define RADFET_EVENT_FLASH_SIZE   0x8000u
+#define RADFET_EVENT_FLASH_START  ((void *) RADFET_EVENT_FLASH_ADDR)
+#define RADFET_EVENT_SLOTS        (RADFET_EVENT_FLASH_SIZE / RADFET_EVENT_SLOT_SIZE)
+#define RADFET_EVENT_SLOT_ADDR(slot) \
+    ((void *)((uint8_t *)RADFET_EVENT_FLASH_START + (uint32_t)(slot) * RADFET_EVENT_SLOT_SIZE))
+
+void radfet_event_init(void);
+void radfet_event_feed(const radfet_sample_t *sample);
+void radfet_event_reset(void);
+bool radfet_event_read_header(uint32_t slot, radfet_event_header_t *hdr);
+
+// ---------- Ring digest tree ----------
+// CRC16 per flash page of the ring, combined pairwise up a binary tree
+// (heap order: node 1 is the root, children of n are 2n and 2n+1, page p
+// is leaf RADFET_DIGEST_LEAVES + p). The ground walks down from the root
+// and fetches only pages whose digests differ from its own ring image.
+#define RADFET_DIGEST_PAGE_SIZE  AVR32_FLASH_PAGE_SIZE
+#define RADFET_DIGEST_LEAVES     ((RADFET_FLASH_END_ADDR - RADFET_FLASH_START_ADDR) / RADFET_DIGEST_PAGE_SIZE)
+#define RADFET_DIGEST_NODES      (2 * RADFET_DIGEST_LEAVES)   // index 0 unused
+
+// DIGEST / PAGE replies start with one status byte; NAK carries nothing else
+#define RADFET_REPLY_ACK         0x06
+#define RADFET_REPLY_NAK         0x15
+
+typedef struct __attribute__((packed)) {
+    uint16_t node;       // queried node
+    uint16_t digest;
+    uint16_t child[2];   // 0 for leaves
+    uint16_t crc16;      // CRC over this struct excluding crc16
+} radfet_digest_reply_t; // = 10 bytes
+
+typedef struct __attribute__((packed)) {
+    uint16_t page;       // followed by RADFET_DIGEST_PAGE_SIZE raw ring bytes
+    uint16_t digest;
+} radfet_page_header_t;
+
+void radfet_digest_init(void);
+void radfet_digest_update(uint32_t offset, size_t length);
+bool radfet_digest_node(uint16_t node, radfet_digest_reply_t *reply);
+
 // ---------- CRC API ----------
 uint16_t crc16_ccitt(const void *data, size_t length);
+uint16_t crc16_ccitt_update(uint16_t crc, const void *data, size_t length);
+
+// ---------- Downlink FEC ----------
+// Shortened Reed-Solomon over GF(256) (poly 0x11D, first root alpha^0).
+// Each 64-byte block is split into FEC_INTERLEAVE codewords by byte
+// interleaving (data and parity), so a burst of up to
+// FEC_INTERLEAVE * FEC_NROOTS / 2 bytes is correctable.
+#define FEC_DATA_SIZE    64
+#define FEC_INTERLEAVE   2
+#define FEC_NROOTS       8      // corrects FEC_NROOTS / 2 byte errors per codeword
+#define FEC_FRAME_SIZE   (FEC_DATA_SIZE + FEC_INTERLEAVE * FEC_NROOTS)   // = 80 bytes
+
+void fec_init(void);
+void fec_encode_block(const uint8_t *data, uint8_t *frame);
 
 // ---------- Sanity checks ----------
+#if (RADFET_EVENT_FLASH_ADDR < RADFET_CODE_LIMIT_ADDR) || \
+    (RADFET_EVENT_FLASH_ADDR + RADFET_EVENT_FLASH_SIZE > RADFET_FLASH_START_ADDR)
+#error "Event region must lie between RADFET_CODE_LIMIT_ADDR and the data ring"
+#endif
+#if (RADFET_EVENT_FLASH_ADDR % AVR32_FLASH_PAGE_SIZE) != 0 || (RADFET_EVENT_FLASH_SIZE % AVR32_FLASH_PAGE_SIZE) != 0
+#error "Event region must be page aligned"
+#endif
+#if ((RADFET_FLASH_END_ADDR - RADFET_FLASH_START_ADDR) % RADFET_DIGEST_PAGE_SIZE) != 0
+#error "Data ring must be a whole number of flash pages for the digest tree"
+#endif
+#if (RADFET_DIGEST_LEAVES & (RADFET_DIGEST_LEAVES - 1)) != 0
+#error "Digest tree needs a power-of-two number of ring pages"
+#endif
+#if RADFET_SETTLE_MIN_MS > RADFET_SETTLE_MAX_MS || RADFET_SETTLE_QUIET_STEPS < 1
+#error "Settle floor must not exceed RADFET_SETTLE_MAX_MS and at least one quiet step is needed"
+#endif
+#if defined(AVR32_FLASH_ADDRESS) && defined(AVR32_FLASH_SIZE)
+#if RADFET_FLASH_END_ADDR > (AVR32_FLASH_ADDRESS + AVR32_FLASH_SIZE)
+#error "Data ring extends past the end of internal flash"
+#endif
+#endif
+
+// Pre-C11 compilers get a negative array size instead of the message
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
-_Static_assert(sizeof(radget_sample_t) == 24, "radfet_sample_t must be 24 bytes");
-_Static_assert(sizeof(radget_packet_t) == 26, "radfet_packet_t must be 26 bytes");
+#define RADFET_STATIC_ASSERT(cond, msg)  _Static_assert(cond, msg)
+#else
+#define RADFET_STATIC_ASSERT(cond, msg)  extern char radfet_static_assert[(cond) ? 1 : -1]
 #endif
 
+RADFET_STATIC_ASSERT(sizeof(radfet_sample_t) == 4 + NUM_RADFET * RADFET_PER_MODULE * 2, "radfet_sample_t must be packed");
+RADFET_STATIC_ASSERT(sizeof(radfet_packet_t) == sizeof(radfet_sample_t) + 2, "radfet_packet_t must be packed");
+
+// Sensor map: every row on a listed expander, pins 0..15, module ids 0..NUM_RADFET-1
+// each used once, and no expander pin driven by two lines.
+// NUM_RADFET expands the table itself, so rows compare against this copy.
+enum { RADFET_TABLE_ROWS = NUM_RADFET };
+#define RADFET_ADDR_EQ_TERM(exp, addr)  || ((addr) == (exp))
+#define RADFET_MOD_BIT_TERM(a, mod, ch, exp, en, r1, r2)  | (1u << (mod))
+#define RADFET_PIN_SUM_TERM(a, mod, ch, exp, en, r1, r2) \
+    + (uint32_t)RADFET_PIN_IF(exp, a, en) + RADFET_PIN_IF(exp, a, r1) + RADFET_PIN_IF(exp, a, r2)
+
+#define RADFET_ROW_CHECK(a, mod, ch, exp, en, r1, r2) \
+    RADFET_STATIC_ASSERT(0 RADFET_EXPANDER_TABLE(RADFET_ADDR_EQ_TERM, exp), \
+                         "RADFET_SENSOR_TABLE module " #mod ": expander not in RADFET_EXPANDER_TABLE"); \
+    RADFET_STATIC_ASSERT((en) < 16 && (r1) < 16 && (r2) < 16, \
+                         "RADFET_SENSOR_TABLE module " #mod ": expander pin out of range 0..15"); \
+    RADFET_STATIC_ASSERT((mod) < RADFET_TABLE_ROWS, \
+                         "RADFET_SENSOR_TABLE module " #mod ": module id out of range");
+RADFET_SENSOR_TABLE(RADFET_ROW_CHECK, 0)
+
+RADFET_STATIC_ASSERT((0u RADFET_SENSOR_TABLE(RADFET_MOD_BIT_TERM, 0)) == (1u << NUM_RADFET) - 1,
+                     "RADFET_SENSOR_TABLE module ids must be unique");
+
+// The sum of the per-pin bits equals their OR only if EN/R1/R2 never share a pin
+#define RADFET_EXPANDER_CHECK(a, addr) \
+    RADFET_STATIC_ASSERT((0u RADFET_SENSOR_TABLE(RADFET_PIN_SUM_TERM, addr)) == \
+                         (RADFET_EN_MASK(addr) | RADFET_R1_MASK(addr) | RADFET_R2_MASK(addr)), \
+                         "RADFET_SENSOR_TABLE: an expander pin is assigned twice");
+RADFET_EXPANDER_TABLE(RADFET_EXPANDER_CHECK, 0)
+
 #endif // RADFET_H
@@ -0,0 +1,108 @@
+/*
+RADFET Ring Digest Tree:
+- CRC16 per flash page over RADFET_FLASH_START..END
+- Pairwise CRC16 of child digests up to a single root (heap-ordered array)
+- Updated incrementally after each ring write; rebuilt in full at boot
+- Node updates (poll task) and node reads (mode_op task) share a mutex
+*/
+
+#include <gs/util/log.h>
+#include <gs/util/time.h>
+#include <gs/util/types.h>
+#include <gs/util/mutex.h>
+#include <wdt.h>
+#include <inttypes.h>
+#include <string.h>
+#include "radfet.h"
+#include <gs/embed/drivers/flash/mcu_flash.h>
+
+#define DIGEST_CHUNK  64   // flash read granularity while hashing a page
+
+static uint16_t   digest_nodes[RADFET_DIGEST_NODES];
+static bool       digest_ready = false;
+static gs_mutex_t digest_lock  = NULL;
+
+static uint16_t digest_hash_page(uint32_t page) {
+    const uint8_t *addr = (const uint8_t *)RADFET_FLASH_START + page * RADFET_DIGEST_PAGE_SIZE;
+    uint8_t chunk[DIGEST_CHUNK];
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t off = 0; off < RADFET_DIGEST_PAGE_SIZE; off += DIGEST_CHUNK) {
+        if (gs_mcu_flash_read_data(chunk, addr + off, DIGEST_CHUNK) != GS_OK) {
+            // Unreadable page: force a mismatch so the ground refetches it
+            log_error("Digest: flash read failed in page %" PRIu32, page);
+            return 0;
+        }
+        crc = crc16_ccitt_update(crc, chunk, DIGEST_CHUNK);
+    }
+    return crc;
+}
+
+// Parent = CRC16 over both child digests, serialized high byte first
+static void digest_hash_node(uint32_t node) {
+    uint16_t left  = digest_nodes[2 * node];
+    uint16_t right = digest_nodes[2 * node + 1];
+    uint8_t children[4] = { left >> 8, left & 0xFF, right >> 8, right & 0xFF };
+    digest_nodes[node] = crc16_ccitt(children, sizeof(children));
+}
+
+void radfet_digest_init(void) {
+    if (gs_mutex_create(&digest_lock) != GS_OK) {
+        log_error("Digest: failed to create mutex; DIGEST/PAGE will NAK");
+        return;
+    }
+
+    uint32_t start = gs_time_rel_ms();
+
+    for (uint32_t page = 0; page < RADFET_DIGEST_LEAVES; page++) {
+        wdt_clear();
+        digest_nodes[RADFET_DIGEST_LEAVES + page] = digest_hash_page(page);
+    }
+    for (uint32_t node = RADFET_DIGEST_LEAVES - 1; node >= 1; node--) {
+        digest_hash_node(node);
+    }
+
+    digest_ready = true;
+    log_info("Digest tree built: root 0x%04X over %u pages in %" PRIu32 " ms",
+             digest_nodes[1], (unsigned int)RADFET_DIGEST_LEAVES,
+             gs_time_diff_ms(start, gs_time_rel_ms()));
+}
+
+// Rehash the page(s) touched by a write at ring offset and their paths to the root
+void radfet_digest_update(uint32_t offset, size_t length) {
+    if (!digest_ready || length == 0) return;
+
+    uint32_t first = offset / RADFET_DIGEST_PAGE_SIZE;
+    uint32_t last  = (offset + length - 1) / RADFET_DIGEST_PAGE_SIZE;
+
+    for (uint32_t page = first; page <= last && page < RADFET_DIGEST_LEAVES; page++) {
+        // Hash the page outside the lock; only the tree update is guarded
+        uint16_t leaf = digest_hash_page(page);
+        uint32_t node = RADFET_DIGEST_LEAVES + page;
+
+        gs_mutex_lock(digest_lock);
+        digest_nodes[node] = leaf;
+        for (node /= 2; node >= 1; node /= 2) {
+            digest_hash_node(node);
+        }
+        gs_mutex_unlock(digest_lock);
+    }
+}
+
+bool radfet_digest_node(uint16_t node, radfet_digest_reply_t *reply) {
+    if (!digest_ready || node == 0 || node >= RADFET_DIGEST_NODES) return false;
+
+    memset(reply, 0, sizeof(*reply));
+    reply->node   = node;
+
+    gs_mutex_lock(digest_lock);
+    reply->digest = digest_nodes[node];
+    if (node < RADFET_DIGEST_LEAVES) {
+        reply->child[0] = digest_nodes[2 * node];
+        reply->child[1] = digest_nodes[2 * node + 1];
+    }
+    gs_mutex_unlock(digest_lock);
+
+    reply->crc16 = crc16_ccitt(reply, sizeof(*reply) - sizeof(reply->crc16));
+    return true;
+}
@@ -0,0 +1,242 @@
+/*
+RADFET Event Capture:
+- RAM circular pre-trigger buffer of high-rate readouts
+- Delta / absolute threshold trigger on any channel (absolute re-arms below threshold)
+- Freezes pre-trigger + post-trigger packets into the event flash region
+- Slots are self-describing (header + CRC) so no extra metadata is persisted
+*/
+
+#include <gs/util/log.h>
+#include <gs/util/types.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include "radfet.h"
+#include <gs/embed/drivers/flash/mcu_flash.h>
+
+// Pre-trigger ring (RAM only)
+static radfet_sample_t pre_buf[RADFET_EVENT_PRE_SAMPLES];
+static uint32_t pre_head  = 0;   // next write position
+static uint32_t pre_count = 0;
+
+static radfet_sample_t prev_sample;
+static bool            have_prev = false;
+
+// Absolute trigger fires on the rising crossing only; arming is taken from
+// the previous readout, so nothing fires until there is one (have_prev)
+static bool     abs_armed[NUM_RADFET][RADFET_PER_MODULE];
+static uint16_t armed_abs_counts = 0;   // abs_counts the arming was computed against
+
+// Event currently being captured
+static radfet_event_header_t cur_hdr;
+static uint32_t cur_slot      = 0;
+static bool     capturing     = false;
+
+static uint32_t next_slot     = 0;
+static uint32_t next_event_id = 0;
+
+radfet_event_config_t radfet_event_config = {
+    .enabled      = false,
+    .rate_ms      = RADFET_EVENT_RATE_MS,
+    .delta_counts = RADFET_EVENT_DELTA_COUNTS,
+    .abs_counts   = RADFET_EVENT_ABS_COUNTS,
+};
+
+static uint16_t calc_event_header_crc(const radfet_event_header_t *hdr) {
+    return crc16_ccitt(hdr, sizeof(radfet_event_header_t) - sizeof(hdr->crc16));
+}
+
+bool radfet_event_read_header(uint32_t slot, radfet_event_header_t *hdr) {
+    if (slot >= RADFET_EVENT_SLOTS) return false;
+
+    gs_error_t err = gs_mcu_flash_read_data(hdr, RADFET_EVENT_SLOT_ADDR(slot), sizeof(*hdr));
+    if (err != GS_OK) return false;
+
+    return (calc_event_header_crc(hdr) == hdr->crc16) &&
+           ((uint32_t)hdr->n_pre + hdr->n_post <= RADFET_EVENT_MAX_PACKETS);
+}
+
+static gs_error_t event_write_packet(uint32_t pos, const radfet_sample_t *sample) {
+    radfet_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sample       = *sample;
+    pkt.sample.index = pos;   // position within the event; trigger is at n_pre - 1
+    pkt.crc16        = crc16_ccitt(&pkt, sizeof(pkt) - sizeof(pkt.crc16));
+
+    uint8_t *addr = (uint8_t *)RADFET_EVENT_SLOT_ADDR(cur_slot)
+                  + sizeof(radfet_event_header_t) + pos * PKT_SIZE;
+    return gs_mcu_flash_write_data(addr, &pkt, sizeof(pkt));
+}
+
+static void event_finish(void) {
+    capturing = false;
+
+    cur_hdr.crc16 = 0;
+    cur_hdr.crc16 = calc_event_header_crc(&cur_hdr);
+
+    gs_error_t err = gs_mcu_flash_write_data(RADFET_EVENT_SLOT_ADDR(cur_slot), &cur_hdr, sizeof(cur_hdr));
+    if (err != GS_OK) {
+        log_error("Failed to write event %" PRIu32 " header: %s", cur_hdr.event_id, gs_error_string(err));
+        return;
+    }
+
+    log_info("Event %" PRIu32 " saved to slot %" PRIu32 " (%u pre, %u post)",
+             cur_hdr.event_id, cur_slot, cur_hdr.n_pre, cur_hdr.n_post);
+
+    next_event_id = cur_hdr.event_id + 1;
+    next_slot     = (cur_slot + 1) % RADFET_EVENT_SLOTS;
+}
+
+static void event_start(int module, int r, int16_t delta) {
+    memset(&cur_hdr, 0, sizeof(cur_hdr));
+    cur_hdr.event_id       = next_event_id;
+    cur_hdr.trigger_sample = radfet_metadata.samples_saved;
+    cur_hdr.rate_ms        = radfet_event_config.rate_ms;
+    cur_hdr.trigger_module = (uint8_t)module;
+    cur_hdr.trigger_r      = (uint8_t)r;
+    cur_hdr.trigger_delta  = delta;
+    cur_slot = next_slot;
+
+    log_info("Event %" PRIu32 " triggered by D%d R%d (delta %d)",
+             cur_hdr.event_id, module + 1, r + 1, delta);
+
+    // Invalidate the slot's old header before overwriting its packets
+    radfet_event_header_t blank;
+    memset(&blank, 0xFF, sizeof(blank));
+    gs_error_t err = gs_mcu_flash_write_data(RADFET_EVENT_SLOT_ADDR(cur_slot), &blank, sizeof(blank));
+    if (err != GS_OK) {
+        log_error("Failed to invalidate event slot %" PRIu32 ": %s", cur_slot, gs_error_string(err));
+        return;
+    }
+
+    // Freeze pre-trigger buffer, oldest first
+    uint32_t oldest = (pre_head + RADFET_EVENT_PRE_SAMPLES - pre_count) % RADFET_EVENT_PRE_SAMPLES;
+    for (uint32_t i = 0; i < pre_count; i++) {
+        err = event_write_packet(i, &pre_buf[(oldest + i) % RADFET_EVENT_PRE_SAMPLES]);
+        if (err != GS_OK) {
+            log_error("Failed to write event pre-trigger packet %" PRIu32 ": %s", i, gs_error_string(err));
+            return;
+        }
+    }
+    cur_hdr.n_pre = (uint16_t)pre_count;
+    pre_count = 0;
+
+    capturing = true;
+    if (RADFET_EVENT_POST_SAMPLES == 0) {
+        event_finish();
+    }
+}
+
+// Returns true if any channel trips the trigger; reports the first one found
+static bool event_check_trigger(const radfet_sample_t *sample, int *module, int *r, int16_t *delta) {
+    uint16_t delta_counts = radfet_event_config.delta_counts;
+    uint16_t abs_counts   = radfet_event_config.abs_counts;
+
+    for (int i = 0; i < NUM_RADFET; i++) {
+        for (int j = 0; j < RADFET_PER_MODULE; j++) {
+            int32_t d = have_prev ? (int32_t)sample->adc[i][j] - prev_sample.adc[i][j] : 0;
+
+            bool tripped = (have_prev && delta_counts > 0 && abs(d) >= delta_counts) ||
+                           (have_prev && abs_counts > 0 && abs_armed[i][j] && sample->adc[i][j] >= abs_counts);
+            if (tripped) {
+                *module = i;
+                *r      = j;
+                *delta  = (int16_t)d;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Channels at or above the absolute threshold stay disarmed until they drop below it
+static void event_update_arming(const radfet_sample_t *sample) {
+    uint16_t abs_counts = radfet_event_config.abs_counts;
+
+    for (int i = 0; i < NUM_RADFET; i++) {
+        for (int j = 0; j < RADFET_PER_MODULE; j++) {
+            abs_armed[i][j] = (abs_counts == 0) || (sample->adc[i][j] < abs_counts);
+        }
+    }
+    armed_abs_counts = abs_counts;
+}
+
+// Drop buffered history and any event in progress (capture disabled)
+void radfet_event_reset(void) {
+    if (capturing) {
+        log_info("Event capture disabled: dropping event %" PRIu32 " in progress", cur_hdr.event_id);
+        capturing = false;
+    }
+    pre_head  = 0;
+    pre_count = 0;
+    have_prev = false;
+    memset(abs_armed, 0, sizeof(abs_armed));
+}
+
+void radfet_event_feed(const radfet_sample_t *sample) {
+    // EVT_CFG moved the absolute threshold: re-arm against this readout
+    // instead of trusting arming computed for the old threshold
+    if (have_prev && radfet_event_config.abs_counts != armed_abs_counts) {
+        have_prev = false;
+    }
+
+    if (capturing) {
+        gs_error_t err = event_write_packet(cur_hdr.n_pre + cur_hdr.n_post, sample);
+        if (err != GS_OK) {
+            log_error("Failed to write event post-trigger packet: %s", gs_error_string(err));
+            capturing = false;
+        } else if (++cur_hdr.n_post >= RADFET_EVENT_POST_SAMPLES) {
+            event_finish();
+        }
+        prev_sample = *sample;
+        event_update_arming(sample);
+        return;
+    }
+
+    int module = 0, r = 0;
+    int16_t delta = 0;
+    bool triggered = event_check_trigger(sample, &module, &r, &delta);
+
+    // The tripping readout is the last pre-trigger packet
+    pre_buf[pre_head] = *sample;
+    pre_head = (pre_head + 1) % RADFET_EVENT_PRE_SAMPLES;
+    if (pre_count < RADFET_EVENT_PRE_SAMPLES) pre_count++;
+
+    prev_sample = *sample;
+    have_prev   = true;
+    event_update_arming(sample);
+
+    if (triggered) {
+        event_start(module, r, delta);
+    }
+}
+
+void radfet_event_init(void) {
+    radfet_event_reset();
+
+    bool found = false;
+    uint32_t newest_slot = 0;
+    uint32_t newest_id   = 0;
+
+    for (uint32_t slot = 0; slot < RADFET_EVENT_SLOTS; slot++) {
+        radfet_event_header_t hdr;
+        if (!radfet_event_read_header(slot, &hdr)) continue;
+
+        if (!found || hdr.event_id > newest_id) {
+            found       = true;
+            newest_id   = hdr.event_id;
+            newest_slot = slot;
+        }
+    }
+
+    if (found) {
+        next_event_id = newest_id + 1;
+        next_slot     = (newest_slot + 1) % RADFET_EVENT_SLOTS;
+    } else {
+        next_event_id = 0;
+        next_slot     = 0;
+    }
+
+    log_info("Event region: %u slots, next event %" PRIu32 " -> slot %" PRIu32,
+             (unsigned int)RADFET_EVENT_SLOTS, next_event_id, next_slot);
+}